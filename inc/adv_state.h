@@ -0,0 +1,34 @@
+#ifndef ADV_STATE_H
+#define ADV_STATE_H
+
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+/* 厂商自定义广播数据:
+ * 厂商 ID(2) + 版本(1) + 设备 ID(3) + 锁状态(1) + 电量(1) + 滚动计数(4) + 截断 MAC(4)
+ * 设备 ID 即 chipId，iOS 扫描端拿不到蓝牙地址，靠它选择密钥
+ */
+#define ADV_STATE_VERSION  0x01
+#define ADV_STATE_ID_LEN   3
+#define ADV_STATE_MAC_LEN  4
+#define ADV_STATE_KEY_LEN  16
+#define ADV_STATE_DATA_LEN (2 + 1 + ADV_STATE_ID_LEN + 1 + 1 + 4 + ADV_STATE_MAC_LEN)
+
+/* 供 main.c 广播数据使用的缓冲区 */
+extern uint8_t adv_state_data[ADV_STATE_DATA_LEN];
+
+/* 读取密钥，生成首帧广播数据 (需在 settings_load 与读取 chipId 之后调用)
+ * 失败时 (如未写入密钥) 返回负数，调用者不应广播 adv_state_data */
+int adv_state_init(void);
+
+/* 重新生成并原地更新广播数据 (锁状态或电量变化时自动调用) */
+void adv_state_refresh(void);
+
+/* 是否正在广播状态数据 (系统工作队列中调用)，为 false 时不应广播 adv_state_data */
+bool adv_state_is_active(void);
+
+/* 写入本机专属 MAC 密钥并持久化 (出厂一次性)，已写入过时返回 -EALREADY
+ * 未启动时随后开始广播状态数据，下次开始广播时生效 */
+int adv_state_key_provision(const uint8_t *key);
+
+#endif /* ADV_STATE_H */
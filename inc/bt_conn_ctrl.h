@@ -1,10 +1,18 @@
 #ifndef BT_CONN_CTRL_H
 #define BT_CONN_CTRL_H
 
+#include <zephyr/bluetooth/conn.h>
+
 /* 注册安全回调并设置固定密码 */
 int app_setup_security(void);
 
-/* 声明外部实现的广播函数 (main.c 实现) */
+/* 连接建立流水线完成后的回调 (传给 conn_setup_init) */
+void bt_conn_ready(struct bt_conn *conn);
+
+/* 声明外部实现的广播函数 (main.c 实现)，任意线程可调用，实际在系统工作队列中启动 */
 void bt_advertise_start(void);
 
+/* 原地更新广播数据 (main.c 实现)，只能在系统工作队列中调用 */
+void bt_advertise_update(void);
+
 #endif /* BT_CONN_CTRL_H */
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef CONN_SETUP_H
+#define CONN_SETUP_H
+
+#include <stdbool.h>
+#include <zephyr/bluetooth/conn.h>
+
+/* 连接建立流水线中的各个步骤 */
+enum conn_setup_step {
+    CONN_SETUP_SECURITY = 0,  /* 加密 (已绑定设备走加密恢复) */
+    CONN_SETUP_MTU,           /* ATT MTU 交换 */
+    CONN_SETUP_DLE,           /* 数据长度扩展 */
+    CONN_SETUP_PHY,           /* 2M PHY */
+    CONN_SETUP_PARAM,         /* 连接参数更新 */
+    CONN_SETUP_STEP_COUNT,
+};
+
+/* 链路就绪回调 (在系统工作队列中调用) */
+typedef void (*conn_setup_ready_cb_t)(struct bt_conn *conn);
+
+/* 解析 CONFIG_APP_CONN_SETUP_ORDER 并初始化工作项 */
+void conn_setup_init(conn_setup_ready_cb_t ready_cb);
+
+/* 连接建立后按配置顺序依次执行各步骤 */
+void conn_setup_start(struct bt_conn *conn);
+
+/* 断开连接时终止流水线 */
+void conn_setup_stop(struct bt_conn *conn);
+
+/* 由连接回调通知某个步骤已完成 (成功或失败) */
+void conn_setup_step_done(struct bt_conn *conn, enum conn_setup_step step);
+
+/* 所有步骤完成、超时或已提交 (连接参数更新只提交、不等待) 后返回 true (任意线程可调用) */
+bool conn_setup_is_ready(struct bt_conn *conn);
+
+/* 记录连接后收到第一条命令的时间 */
+void conn_setup_mark_command(struct bt_conn *conn);
+
+#endif /* CONN_SETUP_H */
@@ -1,9 +1,18 @@
 #ifndef GATT_SVC_H
 #define GATT_SVC_H
 
+#include <stdbool.h>
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/uuid.h>
 
 /* 供 main.c 广播数据使用的 UUID 声明 */
 extern struct bt_uuid_16 adv_uuid;
 
+/* 查询指定连接是否已开启 0xFEC8 通知 */
+bool gatt_svc_notify_enabled(struct bt_conn *conn);
+
+/* 通过 0xFEC8 向指定连接发送通知 */
+int gatt_svc_notify(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+
 #endif /* GATT_SVC_H */
\ No newline at end of file
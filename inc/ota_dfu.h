@@ -0,0 +1,10 @@
+#ifndef OTA_DFU_H
+#define OTA_DFU_H
+
+/* 注册 MCUmgr 镜像管理回调，统计升级耗时与有效吞吐率 (kbit/s) */
+void ota_dfu_init(void);
+
+/* 断开连接时结束当前这段升级统计，续传会在新连接上重新开始计时 */
+void ota_dfu_conn_reset(void);
+
+#endif /* OTA_DFU_H */
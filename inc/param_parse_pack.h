@@ -10,6 +10,12 @@
 /* 2. 定义命令 ID */
 #define CMD_FTE_BleUnlockSetCmd 0x01
 #define CMD_FTE_BleLockSetCmd   0x02
+#define CMD_FTE_TelemetryDelta    0x10  /* 遥测增量帧 (设备 -> 手机) */
+#define CMD_FTE_TelemetryKeyFrame 0x11  /* 遥测关键帧 (设备 -> 手机) */
+#define CMD_FTE_AdvKeySetCmd      0x20  /* 写入广播状态 MAC 密钥 (出厂一次性) */
+
+/* CMD_FTE_AdvKeySetCmd 负载长度 (AES-128 密钥) */
+#define CMD_ADV_KEY_LEN 16
 
 /* 3. 声明解析函数 */
 /**
@@ -22,4 +28,26 @@
  */
 int param_parse(const uint8_t *dataIn, uint8_t inLen, uint8_t *dataOut, uint8_t *outLen);
 
+/**
+ * @brief 封装命令回复: 包头 + 命令 + 结果 + chipId + 异或校验
+ * @param cmdType 命令 ID
+ * @param status  结果 (0x01 成功, 0x00 失败)
+ * @param dataOut 输出缓冲区 (至少 7 字节)
+ * @param outLen  输出长度指针
+ * @return 0 成功, 负数失败
+ */
+int param_pack_reply(uint8_t cmdType, uint8_t status, uint8_t *dataOut, uint8_t *outLen);
+
+/**
+ * @brief 封装设备主动上报的数据帧: 包头 + 命令 + 负载 + 异或校验
+ * @param cmdType    命令 ID
+ * @param payload    负载数据
+ * @param payloadLen 负载长度
+ * @param dataOut    输出缓冲区 (至少 payloadLen + 3 字节)
+ * @param outLen     输出长度指针
+ * @return 0 成功, 负数失败
+ */
+int param_pack_frame(uint8_t cmdType, const uint8_t *payload, uint8_t payloadLen,
+                     uint8_t *dataOut, uint8_t *outLen);
+
 #endif /* PARAM_PARSE_PACK_H */
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <zephyr/types.h>
+#include <zephyr/sys/slist.h>
+#include <zephyr/bluetooth/conn.h>
+
+/* 遥测字段 (顺序即编码时位图中的 bit 序号) */
+enum telem_field {
+    TELEM_LOCK_STATE = 0,   /* 锁状态: TELEM_UNLOCKED / TELEM_LOCKED */
+    TELEM_BATTERY,          /* 电量 (%) */
+    TELEM_SPEED,            /* 速度 (0.1 km/h) */
+    TELEM_FAULT_FLAGS,      /* 故障标志位 */
+    TELEM_FIELD_COUNT,
+};
+
+#define TELEM_UNLOCKED 0
+#define TELEM_LOCKED   1
+
+/* 字段变化监听者，field_mask 中置位的字段 (BIT(enum telem_field)) 变化时回调 */
+struct telemetry_listener {
+    sys_snode_t node;
+    uint8_t field_mask;
+    void (*changed)(enum telem_field field, int32_t value);
+};
+
+/* 初始化字段默认值与发布工作项 */
+void telemetry_init(void);
+
+/* 更新字段值，超出死区时向已订阅的连接推送增量通知 */
+void telemetry_set(enum telem_field field, int32_t value);
+
+/* 注册字段变化监听者 (初始化阶段调用)，回调在 telemetry_set() 的调用者上下文中执行 */
+void telemetry_listener_register(struct telemetry_listener *listener);
+
+/* 读取字段当前值 */
+int32_t telemetry_get(enum telem_field field);
+
+/* 订阅状态变化时调用，新订阅者会立即收到一帧完整关键帧 */
+void telemetry_resync(void);
+
+/* 断开连接时清除该连接的发布状态 */
+void telemetry_conn_reset(struct bt_conn *conn);
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,272 @@
+#include "adv_state.h"
+#include "bt_conn_ctrl.h"
+#include "telemetry.h"
+#include "main.h"
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/crypto.h>
+#include <zephyr/settings/settings.h>
+
+LOG_MODULE_REGISTER(adv_state, LOG_LEVEL_INF);
+
+/* 计数器每前进这么多才写一次 Flash，重启后从下一个块开始，保证不回退 */
+#define ADV_COUNTER_BLOCK 256
+
+/* MAC 输入 (除 MAC 外的全部字段) 必须放进一个 AES 分组 */
+BUILD_ASSERT(ADV_STATE_DATA_LEN - ADV_STATE_MAC_LEN <= 16, "adv state does not fit one AES block");
+
+uint8_t adv_state_data[ADV_STATE_DATA_LEN];
+
+static uint8_t mac_key[ADV_STATE_KEY_LEN];
+static bool key_provisioned;    /* 已从 settings 读到本机专属密钥 */
+static uint32_t counter;        /* 当前滚动计数 */
+static uint32_t counter_limit;  /* 已持久化的计数上限 */
+static struct k_work_delayable refresh_work;
+static bool initialized;        /* 已开始广播状态数据 (只在系统工作队列中写入) */
+
+/* 写入本机专属密钥 (蓝牙 RX 线程接收，系统工作队列中生效) */
+static uint8_t pending_key[ADV_STATE_KEY_LEN];
+static atomic_t provision_busy;
+static void provision_handler(struct k_work *work);
+static K_WORK_DEFINE(provision_work, provision_handler);
+
+/* =========================================================================
+ *  Part 1: 持久化 (滚动计数、本机专属密钥)
+ * ========================================================================= */
+
+static int adv_state_settings_set(const char *name, size_t len,
+                                  settings_read_cb read_cb, void *cb_arg)
+{
+    const char *next;
+
+    if (settings_name_steq(name, "cnt", &next) && !next) {
+        if (len != sizeof(counter_limit)) {
+            return -EINVAL;
+        }
+        return MIN(read_cb(cb_arg, &counter_limit, sizeof(counter_limit)), 0);
+    }
+
+    /* 出厂时写入的本机专属密钥 */
+    if (settings_name_steq(name, "key", &next) && !next) {
+        if (len != sizeof(mac_key)) {
+            return -EINVAL;
+        }
+        ssize_t rc = read_cb(cb_arg, mac_key, sizeof(mac_key));
+        key_provisioned = (rc == sizeof(mac_key));
+        return MIN(rc, 0);
+    }
+
+    return -ENOENT;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(adv_state, "adv_state", NULL, adv_state_settings_set,
+                               NULL, NULL);
+
+static void counter_reserve(void)
+{
+    counter_limit += ADV_COUNTER_BLOCK;
+
+    int err = settings_save_one("adv_state/cnt", &counter_limit, sizeof(counter_limit));
+    if (err) {
+        LOG_WRN("Failed to save adv counter (err %d)", err);
+    }
+}
+
+/* =========================================================================
+ *  Part 2: 广播数据生成
+ * ========================================================================= */
+
+/**
+ * @brief 生成广播数据并计算截断 MAC
+ * @details MAC = AES-128(key, 厂商 ID | 版本 | 设备 ID | 锁状态 | 电量 | 计数 | 0x00 补齐)
+ *          的前 ADV_STATE_MAC_LEN 字节。输入固定为一个分组，单块 AES 即可作为 MAC；
+ *          设备 ID 参与运算，防止把一辆车的广播包冒充成另一辆车。
+ *          只使用广播包内的字段，扫描端 (包括拿不到蓝牙地址的 iOS) 可直接复算。
+ */
+static int adv_state_build(uint8_t *out)
+{
+    uint8_t block[16] = {0};
+    uint8_t enc[16];
+    uint8_t len = 0;
+
+    sys_put_le16(CONFIG_APP_ADV_STATE_COMPANY_ID, &out[len]);
+    len += 2;
+    out[len++] = ADV_STATE_VERSION;
+    memcpy(&out[len], chipId, ADV_STATE_ID_LEN);
+    len += ADV_STATE_ID_LEN;
+    out[len++] = (uint8_t)telemetry_get(TELEM_LOCK_STATE);
+    out[len++] = (uint8_t)telemetry_get(TELEM_BATTERY);
+    sys_put_le32(counter, &out[len]);
+    len += 4;
+
+    memcpy(block, out, len);
+
+    int err = bt_encrypt_be(mac_key, block, enc);
+    if (err) {
+        return err;
+    }
+
+    memcpy(&out[len], enc, ADV_STATE_MAC_LEN);
+    return 0;
+}
+
+/**
+ * @brief 计数加一、重新生成数据并原地更新广播 (无需重启广播)
+ */
+static void refresh_handler(struct k_work *work)
+{
+    uint8_t data[ADV_STATE_DATA_LEN];
+
+    counter++;
+    if (counter >= counter_limit) {
+        counter_reserve();
+    }
+
+    int err = adv_state_build(data);
+    if (err) {
+        LOG_ERR("Adv state MAC failed (err %d)", err);
+        return;
+    }
+
+    /* 与 bt_advertise_start() 同在系统工作队列中执行，协议栈不会读到写了一半的数据 */
+    memcpy(adv_state_data, data, sizeof(adv_state_data));
+    bt_advertise_update();
+
+    /* 状态不变时也定期滚动计数，扫描端可据此识别过期或重放的广播包 */
+    k_work_schedule(&refresh_work, K_SECONDS(CONFIG_APP_ADV_STATE_REFRESH_S));
+}
+
+/* =========================================================================
+ *  Part 3: 对外接口
+ * ========================================================================= */
+
+/**
+ * @brief 锁状态或电量变化 (telemetry 监听回调)
+ */
+static void adv_state_field_changed(enum telem_field field, int32_t value)
+{
+    adv_state_refresh();
+}
+
+static struct telemetry_listener adv_state_listener = {
+    .field_mask = BIT(TELEM_LOCK_STATE) | BIT(TELEM_BATTERY),
+    .changed = adv_state_field_changed,
+};
+
+/**
+ * @brief 确定 MAC 密钥
+ * @details 优先使用出厂写入 settings "adv_state/key" 的本机专属密钥；
+ *          CONFIG_APP_ADV_STATE_KEY 仅供开发调试 (所有设备共用，编译时会给出警告)。
+ */
+static int adv_state_key_load(void)
+{
+    if (key_provisioned) {
+        return 0;
+    }
+
+    if (strlen(CONFIG_APP_ADV_STATE_KEY) == 0) {
+        LOG_WRN("No adv state key provisioned, state is not advertised until provisioned");
+        return -ENOENT;
+    }
+
+    if (hex2bin(CONFIG_APP_ADV_STATE_KEY, strlen(CONFIG_APP_ADV_STATE_KEY),
+                mac_key, sizeof(mac_key)) != sizeof(mac_key)) {
+        LOG_ERR("CONFIG_APP_ADV_STATE_KEY must be 32 hex characters");
+        return -EINVAL;
+    }
+
+    LOG_WRN("Using shared development key for adv state MAC");
+    return 0;
+}
+
+/**
+ * @brief 预留滚动计数、生成首帧数据并开始周期刷新 (系统工作队列中调用)
+ */
+static int adv_state_start(void)
+{
+    /* 跳过上次可能已用过的计数 */
+    counter = counter_limit;
+    counter_reserve();
+
+    int err = adv_state_build(adv_state_data);
+    if (err) {
+        LOG_ERR("Adv state MAC failed (err %d)", err);
+        return err;
+    }
+
+    initialized = true;
+    telemetry_listener_register(&adv_state_listener);
+    k_work_schedule(&refresh_work, K_SECONDS(CONFIG_APP_ADV_STATE_REFRESH_S));
+    LOG_INF("Adv state initialized, counter %u", counter);
+
+    return 0;
+}
+
+/**
+ * @brief 新写入的密钥生效: 未启动时开始广播状态数据，已启动 (开发密钥) 时立即换用新密钥
+ */
+static void provision_handler(struct k_work *work)
+{
+    memcpy(mac_key, pending_key, sizeof(mac_key));
+    memset(pending_key, 0, sizeof(pending_key));
+    key_provisioned = true;
+
+    if (initialized) {
+        k_work_reschedule(&refresh_work, K_NO_WAIT);
+    } else if (adv_state_start() == 0) {
+        /* 正在广播时加入厂商数据; 已连接未广播时由下次 bt_advertise_start 带上 */
+        bt_advertise_update();
+    }
+}
+
+int adv_state_init(void)
+{
+    k_work_init_delayable(&refresh_work, refresh_handler);
+
+    int err = adv_state_key_load();
+    if (err) {
+        return err;
+    }
+
+    return adv_state_start();
+}
+
+void adv_state_refresh(void)
+{
+    if (!initialized) {
+        return;
+    }
+
+    k_work_reschedule(&refresh_work, K_NO_WAIT);
+}
+
+bool adv_state_is_active(void)
+{
+    return initialized;
+}
+
+int adv_state_key_provision(const uint8_t *key)
+{
+    /* 只允许写入一次，已有本机专属密钥时拒绝覆盖 */
+    if (key_provisioned || atomic_set(&provision_busy, 1)) {
+        return -EALREADY;
+    }
+
+    int err = settings_save_one("adv_state/key", key, ADV_STATE_KEY_LEN);
+    if (err) {
+        LOG_ERR("Failed to save adv state key (err %d)", err);
+        atomic_clear(&provision_busy);
+        return err;
+    }
+
+    memcpy(pending_key, key, sizeof(pending_key));
+    k_work_submit(&provision_work);
+    LOG_INF("Adv state key provisioned");
+
+    return 0;
+}
@@ -1,5 +1,8 @@
 #include "bt_conn_ctrl.h"
 #include "main.h"
+#include "conn_setup.h"
+#include "telemetry.h"
+#include "ota_dfu.h"
 #include <zephyr/logging/log.h>
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/gap.h>
@@ -27,25 +30,9 @@ static void connected(struct bt_conn *conn, uint8_t err)
     bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
     LOG_INF("Connected to: %s", addr);
 
-    /* 更新连接参数: 
-     * Min/Max Interval: 30ms-50ms (相对快速的响应)
-     * Latency: 0 (无延迟)
-     * Timeout: 4000ms (4秒超时)
-     */
-    struct bt_le_conn_param *param = BT_LE_CONN_PARAM(
-        BT_GAP_INIT_CONN_INT_MIN, BT_GAP_INIT_CONN_INT_MAX, 0, 400);
-
-    int param_err = bt_conn_le_param_update(conn, param);
-    if (param_err) {
-        LOG_WRN("Param update request failed: %d", param_err);
-    }
-
-    /* 请求 L2 安全等级 (Just Works: 加密但无认证) */
-    /* 注意：如果已经配对过，这里会直接启用加密；如果是新设备，会触发配对流程 */
-    int sec_err = bt_conn_set_security(conn, BT_SECURITY_L2);
-    if (sec_err) {
-        LOG_WRN("Failed to set security (err %d)", sec_err);
-    }
+    /* 安全、MTU、DLE、PHY、连接参数按 CONFIG_APP_CONN_SETUP_ORDER 依次执行，
+     * 避免多个链路层流程同时发起在控制器中冲突 */
+    conn_setup_start(conn);
 }
 
 /**
@@ -56,6 +43,12 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
     LOG_INF("Disconnected (reason 0x%02x)", reason);
 
     LED_STATUS = BL_UNCONNECTED;
+
+    conn_setup_stop(conn);
+    telemetry_conn_reset(conn);
+#if defined(CONFIG_APP_OTA_DFU)
+    ota_dfu_conn_reset();
+#endif
     
     // 断开后立即重新开始广播，等待下一次连接
     bt_advertise_start(); 
@@ -71,6 +64,8 @@ static void le_param_updated(struct bt_conn *conn, uint16_t interval,
     // Interval * 1.25ms = 实际时间
     LOG_INF("Connection parameters updated: interval %d (%.2f ms), latency %d, timeout %d ms",
             interval, interval * 1.25, latency, timeout * 10);
+
+    conn_setup_step_done(conn, CONN_SETUP_PARAM);
 }
 
 /**
@@ -81,6 +76,8 @@ static void le_phy_updated(struct bt_conn *conn,
                            struct bt_conn_le_phy_info *param)
 {
     LOG_INF("PHY updated: TX PHY %u, RX PHY %u", param->tx_phy, param->rx_phy);
+
+    conn_setup_step_done(conn, CONN_SETUP_PHY);
 }
 
 /**
@@ -102,6 +99,8 @@ static void security_changed(struct bt_conn *conn, bt_security_t level,
     } else {
         LOG_ERR("Security failed: %s level %u err %d", addr, level, err);
     }
+
+    conn_setup_step_done(conn, CONN_SETUP_SECURITY);
 }
 
 /**
@@ -113,6 +112,18 @@ static void le_data_len_updated(struct bt_conn *conn,
 {
     LOG_INF("Data length updated: TX %u bytes, RX %u bytes", 
             info->tx_max_len, info->rx_max_len);
+
+    conn_setup_step_done(conn, CONN_SETUP_DLE);
+}
+
+/**
+ * @brief 链路就绪回调
+ * @details 安全/MTU/DLE/PHY/连接参数全部完成或超时后由 conn_setup 调用，
+ *          此时再开始推送遥测，避免通知与链路层流程交错。
+ */
+void bt_conn_ready(struct bt_conn *conn)
+{
+    telemetry_resync();
 }
 
 /* 注册连接回调结构体 */
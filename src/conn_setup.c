@@ -0,0 +1,414 @@
+#include "conn_setup.h"
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/gatt.h>
+
+LOG_MODULE_REGISTER(conn_setup, LOG_LEVEL_INF);
+
+/* 单个步骤的状态 */
+enum step_state {
+    STEP_PENDING = 0,   /* 尚未执行 */
+    STEP_RUNNING,       /* 已发起，等待回调 */
+    STEP_DONE,          /* 回调已到达 */
+    STEP_ISSUED,        /* 已提交给协议栈，不等待回调 */
+    STEP_TIMEOUT,       /* 等待超时 */
+    STEP_SKIPPED,       /* 无需执行或发起失败 */
+};
+
+static const char step_code[CONN_SETUP_STEP_COUNT] = { 's', 'm', 'd', 'p', 'c' };
+static const char *const step_name[CONN_SETUP_STEP_COUNT] = {
+    "security", "mtu", "dle", "phy", "param",
+};
+static const char *const state_name[] = {
+    "pending", "running", "done", "issued", "timeout", "skipped",
+};
+
+/* 从 Kconfig 解析出的默认执行顺序 */
+static uint8_t base_order[CONN_SETUP_STEP_COUNT];
+static uint8_t base_order_len;
+
+/* 当前连接的流水线上下文 (本应用只有一个外设连接) */
+static struct {
+    struct bt_conn *conn;
+    uint8_t order[CONN_SETUP_STEP_COUNT];
+    uint8_t order_len;
+    uint8_t pos;                                /* 当前执行到 order 中的位置 */
+    atomic_t done;                              /* 回调到达的步骤位图 */
+    enum step_state state[CONN_SETUP_STEP_COUNT];
+    int64_t start_ms[CONN_SETUP_STEP_COUNT];
+    uint32_t phase_ms[CONN_SETUP_STEP_COUNT];   /* 各步骤耗时 */
+    int64_t connect_ms;                         /* 连接建立时间 */
+    bool bonded;
+    atomic_t ready;                             /* 其他线程可读，用原子变量 */
+    bool command_seen;
+    conn_setup_ready_cb_t ready_cb;
+    struct k_work advance_work;
+    struct k_work_delayable timeout_work;
+} setup;
+
+/* =========================================================================
+ *  Part 1: 各步骤的发起函数
+ *  返回 0 表示已发起，等待回调；返回 STEP_START_ISSUED 表示已提交但不等待；
+ *  返回负数表示跳过该步骤
+ * ========================================================================= */
+
+#define STEP_START_ISSUED 1
+
+static int step_security_start(struct bt_conn *conn)
+{
+    if (bt_conn_get_security(conn) >= BT_SECURITY_L2) {
+        return -EALREADY;
+    }
+
+    /* 已绑定设备：手机收到安全请求后直接用保存的 LTK 启动加密 (无需重新配对) */
+    return bt_conn_set_security(conn, BT_SECURITY_L2);
+}
+
+#if defined(CONFIG_BT_GATT_CLIENT)
+static void mtu_exchange_cb(struct bt_conn *conn, uint8_t err,
+                            struct bt_gatt_exchange_params *params)
+{
+    if (err) {
+        LOG_WRN("MTU exchange failed (err %u)", err);
+    } else {
+        LOG_INF("MTU exchanged: %u bytes", bt_gatt_get_mtu(conn));
+    }
+
+    conn_setup_step_done(conn, CONN_SETUP_MTU);
+}
+
+static struct bt_gatt_exchange_params mtu_exchange_params = {
+    .func = mtu_exchange_cb,
+};
+#endif
+
+static int step_mtu_start(struct bt_conn *conn)
+{
+#if defined(CONFIG_BT_GATT_CLIENT)
+    return bt_gatt_exchange_mtu(conn, &mtu_exchange_params);
+#else
+    return -ENOTSUP;
+#endif
+}
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+/* 本机可发送的最大数据长度，受 ACL 发送缓冲区限制 */
+#define DLE_LOCAL_TX_MAX MIN(CONFIG_BT_BUF_ACL_TX_SIZE, BT_GAP_DATA_LEN_MAX)
+#endif
+
+static int step_dle_start(struct bt_conn *conn)
+{
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    struct bt_conn_info info;
+
+    /* 已达本机上限时请求不会改变任何值，控制器不会上报数据长度变化事件 */
+    if (bt_conn_get_info(conn, &info) == 0 &&
+        info.le.data_len->tx_max_len >= DLE_LOCAL_TX_MAX) {
+        return -EALREADY;
+    }
+
+    int err = bt_conn_le_data_len_update(
+        conn, BT_LE_DATA_LEN_PARAM(DLE_LOCAL_TX_MAX, BT_GAP_DATA_TIME_MAX));
+    if (err) {
+        return err;
+    }
+
+    /* 对端只支持 27 字节时协商结果不变，同样没有事件，等待回调只会卡到超时；
+     * 控制器按顺序执行链路层流程，后续步骤仍排在本次协商之后 */
+    return STEP_START_ISSUED;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+static int step_phy_start(struct bt_conn *conn)
+{
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+    struct bt_conn_info info;
+
+    if (bt_conn_get_info(conn, &info) == 0 &&
+        info.le.phy->tx_phy == BT_GAP_LE_PHY_2M &&
+        info.le.phy->rx_phy == BT_GAP_LE_PHY_2M) {
+        return -EALREADY;
+    }
+
+    return bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+#else
+    return -ENOTSUP;
+#endif
+}
+
+static int step_param_start(struct bt_conn *conn)
+{
+    /* 30ms-50ms 间隔, 无延迟, 4 秒超时; 参数已满足时协议栈返回 -EALREADY */
+    struct bt_le_conn_param *param = BT_LE_CONN_PARAM(
+        BT_GAP_INIT_CONN_INT_MIN, BT_GAP_INIT_CONN_INT_MAX, 0, 400);
+
+    int err = bt_conn_le_param_update(conn, param);
+    if (err) {
+        return err;
+    }
+
+    /* 外设在 CONFIG_BT_CONN_PARAM_UPDATE_TIMEOUT (GAP 建议的 5 秒，留给中心设备完成服务发现)
+     * 到期前只保存参数，到期后协议栈才发出请求。该步骤只提交参数、不计入就绪条件，
+     * 实际生效时间由 conn_setup_step_done() 另行记录 */
+    return STEP_START_ISSUED;
+}
+
+static int (*const step_start[CONN_SETUP_STEP_COUNT])(struct bt_conn *conn) = {
+    [CONN_SETUP_SECURITY] = step_security_start,
+    [CONN_SETUP_MTU] = step_mtu_start,
+    [CONN_SETUP_DLE] = step_dle_start,
+    [CONN_SETUP_PHY] = step_phy_start,
+    [CONN_SETUP_PARAM] = step_param_start,
+};
+
+/* =========================================================================
+ *  Part 2: 流水线调度
+ * ========================================================================= */
+
+static k_timeout_t step_timeout(enum conn_setup_step step)
+{
+    if (step == CONN_SETUP_SECURITY && !setup.bonded) {
+        return K_MSEC(CONFIG_APP_CONN_SETUP_PAIRING_TIMEOUT_MS);
+    }
+
+    return K_MSEC(CONFIG_APP_CONN_SETUP_STEP_TIMEOUT_MS);
+}
+
+/**
+ * @brief 所有步骤结束，打印各阶段耗时
+ */
+static void setup_finish(int64_t now)
+{
+    atomic_set(&setup.ready, 1);
+
+    LOG_INF("Link ready %u ms after connect (%s peer)",
+            (uint32_t)(now - setup.connect_ms), setup.bonded ? "bonded" : "new");
+
+    for (uint8_t i = 0; i < setup.order_len; i++) {
+        uint8_t step = setup.order[i];
+
+        LOG_INF("  %-8s %5u ms  %s", step_name[step], setup.phase_ms[step],
+                state_name[setup.state[step]]);
+    }
+
+    if (setup.ready_cb) {
+        setup.ready_cb(setup.conn);
+    }
+}
+
+/**
+ * @brief 推进流水线
+ * @details 运行在系统工作队列中，与超时处理串行执行，因此无需加锁。
+ */
+static void setup_advance(struct k_work *work)
+{
+    int64_t now = k_uptime_get();
+
+    if (setup.conn == NULL || atomic_get(&setup.ready)) {
+        return;
+    }
+
+    while (setup.pos < setup.order_len) {
+        uint8_t step = setup.order[setup.pos];
+
+        if (setup.state[step] == STEP_PENDING) {
+            setup.state[step] = STEP_RUNNING;
+            setup.start_ms[step] = now;
+            atomic_clear_bit(&setup.done, step);
+
+            int err = step_start[step](setup.conn);
+            if (err == 0) {
+                k_work_reschedule(&setup.timeout_work, step_timeout(step));
+                return;
+            }
+
+            if (err == STEP_START_ISSUED) {
+                setup.state[step] = STEP_ISSUED;
+            } else {
+                if (err != -EALREADY) {
+                    LOG_WRN("Step %s not started (err %d)", step_name[step], err);
+                }
+                setup.state[step] = STEP_SKIPPED;
+            }
+        } else if (setup.state[step] == STEP_RUNNING) {
+            if (!atomic_test_bit(&setup.done, step)) {
+                return;
+            }
+            setup.state[step] = STEP_DONE;
+            k_work_cancel_delayable(&setup.timeout_work);
+        }
+
+        setup.phase_ms[step] = (uint32_t)(now - setup.start_ms[step]);
+        setup.pos++;
+    }
+
+    setup_finish(now);
+}
+
+static void setup_timeout(struct k_work *work)
+{
+    if (setup.conn == NULL || setup.pos >= setup.order_len) {
+        return;
+    }
+
+    uint8_t step = setup.order[setup.pos];
+
+    if (setup.state[step] == STEP_RUNNING && !atomic_test_bit(&setup.done, step)) {
+        LOG_WRN("Step %s timed out", step_name[step]);
+        setup.state[step] = STEP_TIMEOUT;
+    }
+
+    setup_advance(NULL);
+}
+
+/* =========================================================================
+ *  Part 3: 对外接口
+ * ========================================================================= */
+
+static void bond_match(const struct bt_bond_info *info, void *user_data)
+{
+    struct bt_conn *conn = user_data;
+
+    if (bt_addr_le_eq(&info->addr, bt_conn_get_dst(conn))) {
+        setup.bonded = true;
+    }
+}
+
+void conn_setup_init(conn_setup_ready_cb_t ready_cb)
+{
+    const char *order = CONFIG_APP_CONN_SETUP_ORDER;
+
+    setup.ready_cb = ready_cb;
+    k_work_init(&setup.advance_work, setup_advance);
+    k_work_init_delayable(&setup.timeout_work, setup_timeout);
+
+    base_order_len = 0;
+    for (const char *c = order; *c != '\0'; c++) {
+        bool known = false;
+
+        for (uint8_t step = 0; step < CONN_SETUP_STEP_COUNT; step++) {
+            if (*c != step_code[step]) {
+                continue;
+            }
+            known = true;
+
+            bool dup = false;
+            for (uint8_t i = 0; i < base_order_len; i++) {
+                dup |= (base_order[i] == step);
+            }
+            if (!dup) {
+                base_order[base_order_len++] = step;
+            }
+        }
+
+        if (!known) {
+            LOG_WRN("Unknown setup step '%c' ignored", *c);
+        }
+    }
+
+    LOG_INF("Connection setup order: %s", order);
+}
+
+void conn_setup_start(struct bt_conn *conn)
+{
+    conn_setup_stop(setup.conn);
+
+    setup.conn = bt_conn_ref(conn);
+    setup.connect_ms = k_uptime_get();
+    setup.pos = 0;
+    atomic_set(&setup.ready, 0);
+    setup.command_seen = false;
+    setup.bonded = false;
+    atomic_clear(&setup.done);
+    for (uint8_t step = 0; step < CONN_SETUP_STEP_COUNT; step++) {
+        setup.state[step] = STEP_PENDING;
+        setup.phase_ms[step] = 0;
+    }
+
+    if (IS_ENABLED(CONFIG_BT_BONDABLE)) {
+        bt_foreach_bond(BT_ID_DEFAULT, bond_match, conn);
+    }
+
+    /* 已绑定设备优先恢复加密：只需一次 LL 加密流程，且手机要等加密后才发命令 */
+    bool hoist = false;
+    if (setup.bonded && IS_ENABLED(CONFIG_APP_CONN_SETUP_BONDED_SECURITY_FIRST)) {
+        for (uint8_t i = 0; i < base_order_len; i++) {
+            hoist |= (base_order[i] == CONN_SETUP_SECURITY);
+        }
+    }
+
+    setup.order_len = 0;
+    if (hoist) {
+        setup.order[setup.order_len++] = CONN_SETUP_SECURITY;
+    }
+    for (uint8_t i = 0; i < base_order_len; i++) {
+        if (hoist && base_order[i] == CONN_SETUP_SECURITY) {
+            continue;
+        }
+        setup.order[setup.order_len++] = base_order[i];
+    }
+
+    k_work_submit(&setup.advance_work);
+}
+
+void conn_setup_stop(struct bt_conn *conn)
+{
+    struct k_work_sync sync;
+
+    if (conn == NULL || conn != setup.conn) {
+        return;
+    }
+
+    k_work_cancel_delayable_sync(&setup.timeout_work, &sync);
+    k_work_cancel_sync(&setup.advance_work, &sync);
+
+    if (!atomic_get(&setup.ready)) {
+        LOG_WRN("Connection closed before link was ready (step %u/%u)",
+                setup.pos, setup.order_len);
+    }
+
+    atomic_set(&setup.ready, 0);
+    bt_conn_unref(setup.conn);
+    setup.conn = NULL;
+}
+
+void conn_setup_step_done(struct bt_conn *conn, enum conn_setup_step step)
+{
+    if (conn != setup.conn || step >= CONN_SETUP_STEP_COUNT) {
+        return;
+    }
+
+    /* 只记录第一次 (之后的更新可能来自 OTA 等其他模块) */
+    if (step == CONN_SETUP_PARAM && !atomic_test_bit(&setup.done, step)) {
+        LOG_INF("Connection parameters applied %u ms after connect",
+                (uint32_t)(k_uptime_get() - setup.connect_ms));
+    }
+
+    atomic_set_bit(&setup.done, step);
+    k_work_submit(&setup.advance_work);
+}
+
+bool conn_setup_is_ready(struct bt_conn *conn)
+{
+    /* 先读 ready 再比较连接: 断开时先清 ready 再清 conn，不会误判为就绪 */
+    return atomic_get(&setup.ready) && conn == setup.conn;
+}
+
+void conn_setup_mark_command(struct bt_conn *conn)
+{
+    if (conn != setup.conn || setup.command_seen) {
+        return;
+    }
+
+    setup.command_seen = true;
+    LOG_INF("First command %u ms after connect (link %s)",
+            (uint32_t)(k_uptime_get() - setup.connect_ms),
+            atomic_get(&setup.ready) ? "ready" : "not ready");
+}
@@ -1,5 +1,9 @@
 #include "gatt_svc.h"
 #include "param_parse_pack.h"
+#include "conn_setup.h"
+#include "telemetry.h"
+#include "adv_state.h"
+#include <errno.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/bluetooth/bluetooth.h>
@@ -14,6 +18,8 @@ static struct bt_uuid_16 write_chrc_uuid = BT_UUID_INIT_16(0xFEC7);
 static struct bt_uuid_16 notify_chrc_uuid = BT_UUID_INIT_16(0xFEC8);
 static struct bt_uuid_16 read_chrc_uuid = BT_UUID_INIT_16(0xFEC9);
 
+BUILD_ASSERT(CMD_ADV_KEY_LEN == ADV_STATE_KEY_LEN, "key command length mismatch");
+
 /* 数据缓存 */
 #define SHARED_DATA_BUFFER_SIZE 20
 static uint8_t shared_data_buffer[SHARED_DATA_BUFFER_SIZE] = {0};
@@ -63,7 +69,12 @@ static ssize_t write_fec7_cb(struct bt_conn *conn, const struct bt_gatt_attr *at
                              const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
 {
     LOG_INF("GATT Write received on 0xFEC7, len: %u", len);
-    LOG_HEXDUMP_INF(buf, len, "Received Data:");
+    // 密钥写入命令不打印内容，避免密钥出现在日志中
+    if (len < 2 || ((const uint8_t *)buf)[1] != CMD_FTE_AdvKeySetCmd)
+    {
+        LOG_HEXDUMP_INF(buf, len, "Received Data:");
+    }
+    conn_setup_mark_command(conn);
 
     // --- 这里是你的核心业务逻辑 ---
     char dataIn[256] = {0};
@@ -88,6 +99,38 @@ static ssize_t write_fec7_cb(struct bt_conn *conn, const struct bt_gatt_attr *at
     }
     else
     {
+        // 解析成功后再更新车辆状态 (param_parse 只负责编解码)
+        switch (dataIn[1])
+        {
+            case CMD_FTE_BleUnlockSetCmd:
+                telemetry_set(TELEM_LOCK_STATE, TELEM_UNLOCKED);
+                break;
+
+            case CMD_FTE_BleLockSetCmd:
+                telemetry_set(TELEM_LOCK_STATE, TELEM_LOCKED);
+                break;
+
+            case CMD_FTE_AdvKeySetCmd:
+            {
+                // 广播状态密钥只能在加密链路上写入一次 (出厂时)
+                int err = -EACCES;
+
+                if (bt_conn_get_security(conn) >= BT_SECURITY_L2)
+                {
+                    err = adv_state_key_provision((const uint8_t *)&dataIn[2]);
+                }
+                if (err)
+                {
+                    LOG_ERR("Adv state key rejected (err %d)", err);
+                    param_pack_reply(CMD_FTE_AdvKeySetCmd, 0x00, (uint8_t *)dataOut, &dataOutLen);
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+
         if (dataOutLen > 0)
         {
             if (is_notify_enabled)
@@ -162,4 +205,17 @@ static void ccc_fec8_cfg_changed_cb(const struct bt_gatt_attr *attr, uint16_t va
     // 更新全局标志位，判断是否开启了 Notify
     is_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
     LOG_INF("Notification state has been changed by client: %s", is_notify_enabled ? "ENABLED" : "DISABLED");
+
+    // 新订阅者需要一帧完整的遥测关键帧
+    telemetry_resync();
+}
+
+bool gatt_svc_notify_enabled(struct bt_conn *conn)
+{
+    return bt_gatt_is_subscribed(conn, &my_service.attrs[4], BT_GATT_CCC_NOTIFY);
+}
+
+int gatt_svc_notify(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+{
+    return bt_gatt_notify(conn, &my_service.attrs[4], data, len);
 }
\ No newline at end of file
@@ -6,7 +6,11 @@
 
 #include "gatt_svc.h"      /* 获取 UUID */
 #include "bt_conn_ctrl.h"  /* 获取安全初始化函数 */
+#include "conn_setup.h"    /* 连接建立流水线 */
+#include "telemetry.h"     /* 状态遥测推送 */
+#include "adv_state.h"     /* 广播中的车辆状态 */
 #include "main.h"
+#include "ota_dfu.h"      /* OTA 升级统计 */
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 
@@ -16,8 +20,17 @@ uint8_t chipId[3] = {0};
 static struct bt_data ad[] = {
     BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
     BT_DATA(BT_DATA_UUID16_ALL, &adv_uuid.val, sizeof(adv_uuid.val)),
+    /* 设备 ID、锁状态、电量、滚动计数与截断 MAC，扫描即可获取，无需连接 (必须放在最后)
+     * 3 + 4 + (2 + 16) = 25 字节，未超过 31 字节的广播包上限 */
+    BT_DATA(BT_DATA_MANUFACTURER_DATA, adv_state_data, sizeof(adv_state_data)),
 };
 
+/* 实际广播的 ad[] 元素个数; adv_state 未启用 (如尚未写入密钥) 时去掉最后的厂商数据 */
+static size_t ad_len(void)
+{
+    return adv_state_is_active() ? ARRAY_SIZE(ad) : ARRAY_SIZE(ad) - 1;
+}
+
 static struct bt_data sd[] = {
     BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, (sizeof(CONFIG_BT_DEVICE_NAME) - 1)),
 };
@@ -29,10 +42,9 @@ static const struct bt_le_adv_param *adv_param = BT_LE_ADV_PARAM(
     NULL
 );
 
-/* 启动广播 */
-void bt_advertise_start(void)
+static void adv_start_handler(struct k_work *work)
 {
-    int err = bt_le_adv_start(adv_param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+    int err = bt_le_adv_start(adv_param, ad, ad_len(), sd, ARRAY_SIZE(sd));
     if (err) {
         LOG_ERR("Advertising failed (err %d)", err);
     } else {
@@ -40,6 +52,25 @@ void bt_advertise_start(void)
     }
 }
 
+static K_WORK_DEFINE(adv_start_work, adv_start_handler);
+
+/* 启动广播
+ * 在系统工作队列中执行，与 adv_state 刷新广播数据串行，避免把写了一半的数据交给协议栈 */
+void bt_advertise_start(void)
+{
+    k_work_submit(&adv_start_work);
+}
+
+/* 状态变化时原地更新广播数据，无需停止/重启广播 (只在系统工作队列中调用) */
+void bt_advertise_update(void)
+{
+    int err = bt_le_adv_update_data(ad, ad_len(), sd, ARRAY_SIZE(sd));
+    /* -EAGAIN: 当前未在广播 (已连接)，下次 bt_advertise_start 会使用新数据 */
+    if (err && err != -EAGAIN) {
+        LOG_WRN("Advertising data update failed (err %d)", err);
+    }
+}
+
 /**
  * @brief 蓝牙就绪回调函数
  * @details 此函数在 bt_enable() 内部被调用，是设置初始 MAC 地址的最佳时机。
@@ -90,7 +121,23 @@ static void bt_ready(int err)
         LOG_ERR("Security setup failed");
     }
 
-    // 4. 在所有初始化完成后，开始广播
+    // 4. 连接建立流水线 (安全/MTU/DLE/PHY/连接参数按序执行)
+    conn_setup_init(bt_conn_ready);
+
+    // 5. 状态遥测 (变化驱动的增量通知)
+    telemetry_init();
+
+    // 6. 广播状态 (需在 settings_load 之后，读取密钥与持久化的滚动计数)
+    if (adv_state_init() != 0) {
+        LOG_ERR("Adv state setup failed, manufacturer data not advertised");
+    }
+
+#if defined(CONFIG_APP_OTA_DFU)
+    // 7. 注册 OTA 升级回调 (耗时、吞吐率统计)
+    ota_dfu_init();
+#endif
+
+    // 8. 在所有初始化完成后，开始广播
     bt_advertise_start();
 }
 
@@ -0,0 +1,187 @@
+#include "ota_dfu.h"
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/mgmt/mcumgr/mgmt/mgmt.h>
+#include <zephyr/mgmt/mcumgr/mgmt/callbacks.h>
+#include <zephyr/mgmt/mcumgr/grp/img_mgmt/img_mgmt.h>
+
+LOG_MODULE_REGISTER(ota_dfu, LOG_LEVEL_INF);
+
+/* 本次连接内的升级统计 (断线重连后的续传视为新的一段) */
+struct dfu_session {
+    bool active;
+    int64_t start_ms;       /* 本段第一包到达时间 */
+    size_t image_size;      /* 镜像总长度 */
+    size_t start_off;       /* 本段起始偏移 (续传时非 0) */
+    size_t received;        /* 本段已接收字节数 */
+    size_t next_report;     /* 下一次打印进度的偏移阈值 */
+};
+
+/* SMP 工作队列 (收包) 与蓝牙 RX 线程 (断开) 都会访问，需持锁读写 */
+static struct dfu_session dfu_stat;
+static struct k_spinlock dfu_lock;
+
+/* 每接收 10% 打印一次进度 */
+#define DFU_PROGRESS_STEP_PCT 10
+
+/**
+ * @brief 将所有 LE 连接切换到指定连接间隔
+ * @details 升级期间使用短间隔，让每个连接事件都能收发多包；结束后恢复默认值。
+ */
+static void dfu_conn_param_apply(struct bt_conn *conn, void *data)
+{
+    const struct bt_le_conn_param *param = data;
+
+    int err = bt_conn_le_param_update(conn, param);
+    if (err) {
+        LOG_WRN("DFU param update request failed: %d", err);
+    }
+}
+
+static void dfu_conn_param_set(uint16_t int_min, uint16_t int_max)
+{
+    struct bt_le_conn_param param = BT_LE_CONN_PARAM_INIT(int_min, int_max, 0, 400);
+
+    bt_conn_foreach(BT_CONN_TYPE_LE, dfu_conn_param_apply, &param);
+}
+
+/**
+ * @brief 打印本段升级的耗时与有效吞吐率
+ * @details 只统计本次连接内实际收到的字节与时间，续传时不包含断线期间。
+ * @param result  结束原因描述
+ * @param session 已结束的本段统计 (持锁复制出的快照)
+ */
+static void dfu_report(const char *result, const struct dfu_session *session)
+{
+    int64_t elapsed_ms = k_uptime_get() - session->start_ms;
+
+    if (elapsed_ms <= 0) {
+        elapsed_ms = 1;
+    }
+
+    /* bit / ms == kbit / s */
+    uint32_t kbps = (uint32_t)(((uint64_t)session->received * 8U) / elapsed_ms);
+
+    LOG_INF("DFU %s: %zu bytes from offset %zu (image %zu) in %lld ms, %u kbit/s",
+            result, session->received, session->start_off, session->image_size,
+            elapsed_ms, kbps);
+}
+
+/**
+ * @brief 结束本段统计并恢复默认连接间隔
+ */
+static void dfu_session_end(const char *result, bool restore_param)
+{
+    struct dfu_session session;
+    k_spinlock_key_t key = k_spin_lock(&dfu_lock);
+
+    session = dfu_stat;
+    dfu_stat.active = false;
+    k_spin_unlock(&dfu_lock, key);
+
+    if (!session.active) {
+        return;
+    }
+
+    dfu_report(result, &session);
+    if (restore_param) {
+        dfu_conn_param_set(BT_GAP_INIT_CONN_INT_MIN, BT_GAP_INIT_CONN_INT_MAX);
+    }
+}
+
+/**
+ * @brief 处理一包镜像数据 (MGMT_EVT_OP_IMG_MGMT_DFU_CHUNK)
+ * @details 新连接上的第一包 (无论 off 是否为 0) 开始新的一段统计并切换到短间隔，
+ *          因为续传时 MCUmgr 不会再次发出 DFU_STARTED。
+ *          持锁只更新统计，日志与连接参数请求在释放锁之后执行。
+ */
+static void dfu_chunk(const struct img_mgmt_upload_check *check)
+{
+    const struct img_mgmt_upload_req *req = check->req;
+    size_t end = req->off + req->img_data.len;
+    size_t image_size;
+    size_t step;
+    bool started = false;
+    bool report = false;
+    k_spinlock_key_t key = k_spin_lock(&dfu_lock);
+
+    if (!dfu_stat.active || req->off == 0) {
+        dfu_stat.active = true;
+        dfu_stat.start_ms = k_uptime_get();
+        dfu_stat.image_size = (size_t)check->action->size;
+        dfu_stat.start_off = req->off;
+        dfu_stat.received = 0;
+        dfu_stat.next_report = req->off;
+        started = true;
+    }
+
+    dfu_stat.received += req->img_data.len;
+    image_size = dfu_stat.image_size;
+
+    step = image_size / (100 / DFU_PROGRESS_STEP_PCT);
+    if (step && end >= dfu_stat.next_report + step) {
+        dfu_stat.next_report = end;
+        report = true;
+    }
+
+    k_spin_unlock(&dfu_lock, key);
+
+    if (started) {
+        dfu_conn_param_set(CONFIG_APP_OTA_DFU_CONN_INTERVAL,
+                           CONFIG_APP_OTA_DFU_CONN_INTERVAL);
+        LOG_INF("DFU upload %s at offset %zu, image size %zu bytes",
+                req->off ? "resumed" : "started", req->off, image_size);
+    }
+
+    if (report) {
+        LOG_INF("DFU progress: %u%%", (uint32_t)(((uint64_t)end * 100U) / image_size));
+    }
+}
+
+/**
+ * @brief MCUmgr 镜像管理事件回调
+ */
+static enum mgmt_cb_return dfu_mgmt_cb(uint32_t event, enum mgmt_cb_return prev_status,
+                                       int32_t *rc, uint16_t *group, bool *abort_more,
+                                       void *data, size_t data_size)
+{
+    switch (event) {
+    case MGMT_EVT_OP_IMG_MGMT_DFU_CHUNK:
+        if (data_size == sizeof(struct img_mgmt_upload_check)) {
+            dfu_chunk(data);
+        }
+        break;
+
+    case MGMT_EVT_OP_IMG_MGMT_DFU_PENDING:
+        dfu_session_end("complete", true);
+        break;
+
+    case MGMT_EVT_OP_IMG_MGMT_DFU_STOPPED:
+        dfu_session_end("aborted", true);
+        break;
+
+    default:
+        break;
+    }
+
+    return MGMT_CB_OK;
+}
+
+static struct mgmt_callback dfu_mgmt_callback = {
+    .callback = dfu_mgmt_cb,
+    .event_id = MGMT_EVT_OP_IMG_MGMT_ALL,
+};
+
+void ota_dfu_conn_reset(void)
+{
+    /* 链路已断开，无需恢复连接参数 */
+    dfu_session_end("interrupted", false);
+}
+
+void ota_dfu_init(void)
+{
+    mgmt_callback_register(&dfu_mgmt_callback);
+    LOG_INF("OTA DFU callbacks registered");
+}
@@ -50,6 +50,40 @@ static int _bleLockSetCmdPack(uint8_t *dataOut, uint8_t *outLen)
 }
 
 
+int param_pack_reply(uint8_t cmdType, uint8_t status, uint8_t *dataOut, uint8_t *outLen)
+{
+    if (dataOut == NULL || outLen == NULL) {
+        return -1; // 参数错误
+    }
+
+    dataOut[0] = SEND_CMD_HEAD;
+    dataOut[1] = cmdType;
+    dataOut[2] = status;
+    dataOut[3] = chipId[0];
+    dataOut[4] = chipId[1];
+    dataOut[5] = chipId[2];
+    dataOut[6] = _xorCheck(dataOut, 6);
+    *outLen = 7;
+    return 0;
+}
+
+int param_pack_frame(uint8_t cmdType, const uint8_t *payload, uint8_t payloadLen,
+                     uint8_t *dataOut, uint8_t *outLen)
+{
+    if ((payload == NULL && payloadLen > 0) || dataOut == NULL || outLen == NULL) {
+        return -1; // 参数错误
+    }
+
+    dataOut[0] = SEND_CMD_HEAD;
+    dataOut[1] = cmdType;
+    if (payloadLen) {
+        memcpy(&dataOut[2], payload, payloadLen);
+    }
+    dataOut[payloadLen + 2] = _xorCheck(dataOut, payloadLen + 2);
+    *outLen = payloadLen + 3;
+    return 0;
+}
+
 int param_parse(const uint8_t *dataIn, uint8_t inLen, uint8_t *dataOut, uint8_t *outLen)
 {
     // 基本检查
@@ -78,6 +112,13 @@ int param_parse(const uint8_t *dataIn, uint8_t inLen, uint8_t *dataOut, uint8_t
             // 不做任何判断，直接封装成功回复
             return _bleLockSetCmdPack(dataOut, outLen);
 
+        case CMD_FTE_AdvKeySetCmd:
+            // 只检查长度，密钥由调用者写入；写入失败时调用者改为失败回复
+            if (inLen != CMD_ADV_KEY_LEN + 3) {
+                return -5; // 长度错误
+            }
+            return param_pack_reply(CMD_FTE_AdvKeySetCmd, 0x01, dataOut, outLen);
+
         default:
             // 其他命令我们不处理
             return -4; // 未知命令
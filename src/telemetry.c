@@ -0,0 +1,285 @@
+#include "telemetry.h"
+#include "gatt_svc.h"
+#include "param_parse_pack.h"
+#include "conn_setup.h"
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/att.h>
+
+LOG_MODULE_REGISTER(telemetry, LOG_LEVEL_INF);
+
+/* 字段描述表 */
+struct telem_field_desc {
+    const char *name;
+    uint8_t size;       /* 编码后的字节数 (1/2/4, 小端) */
+    uint32_t deadband;  /* 与上次发送值相差超过该值才发送; 0 表示任意变化都发送 */
+    int32_t init;       /* 上电默认值 */
+};
+
+/* 各字段编码后的字节数 (新增字段时同步更新 TELEM_VALUES_MAX) */
+#define TELEM_LOCK_SIZE    1
+#define TELEM_BATTERY_SIZE 1
+#define TELEM_SPEED_SIZE   2
+#define TELEM_FAULTS_SIZE  2
+#define TELEM_VALUES_MAX   (TELEM_LOCK_SIZE + TELEM_BATTERY_SIZE + TELEM_SPEED_SIZE + \
+                            TELEM_FAULTS_SIZE)
+
+static const struct telem_field_desc field_desc[TELEM_FIELD_COUNT] = {
+    [TELEM_LOCK_STATE]  = { "lock",    TELEM_LOCK_SIZE, 0, TELEM_LOCKED },
+    [TELEM_BATTERY]     = { "battery", TELEM_BATTERY_SIZE,
+                            CONFIG_APP_TELEMETRY_BATTERY_DEADBAND, 100 },
+    [TELEM_SPEED]       = { "speed",   TELEM_SPEED_SIZE, CONFIG_APP_TELEMETRY_SPEED_DEADBAND, 0 },
+    [TELEM_FAULT_FLAGS] = { "faults",  TELEM_FAULTS_SIZE, 0, 0 },
+};
+
+/* 变化位图为 1 字节 */
+BUILD_ASSERT(TELEM_FIELD_COUNT <= 8, "telemetry bitmap is limited to 8 fields");
+BUILD_ASSERT(TELEM_FIELD_COUNT == 4, "TELEM_VALUES_MAX must include every field size");
+
+#define TELEM_ALL_FIELDS ((uint8_t)BIT_MASK(TELEM_FIELD_COUNT))
+
+/* 负载: 序号(1) + 位图(1) + 各字段值 */
+#define TELEM_PAYLOAD_MAX (2 + TELEM_VALUES_MAX)
+/* 帧: 包头(1) + 命令(1) + 负载 + 校验(1) */
+#define TELEM_FRAME_MAX   (TELEM_PAYLOAD_MAX + 3)
+
+/* 关键帧必须能放进默认 MTU (23) 下的一条通知: 扣除操作码(1) + 句柄(2) */
+BUILD_ASSERT(TELEM_FRAME_MAX <= BT_ATT_DEFAULT_LE_MTU - 3,
+             "telemetry keyframe does not fit in a default-MTU notification");
+
+/* 字段当前值 (任意线程可写) */
+static atomic_t field_value[TELEM_FIELD_COUNT];
+
+/* 每个连接的发布状态 */
+#define CONN_FLAG_SUBSCRIBED 0  /* 上一轮检查时已订阅 */
+#define CONN_FLAG_KEYFRAME   1  /* 下一帧必须是关键帧 */
+
+struct telem_conn {
+    atomic_t flags;
+    int32_t sent[TELEM_FIELD_COUNT];  /* 该连接最近一次收到的各字段值 */
+    int64_t last_tx_ms;               /* 最近一次发送时间 (限速) */
+    int64_t last_key_ms;              /* 最近一次关键帧时间 */
+    uint8_t seq;                      /* 帧序号，手机端可据此发现丢帧并等待关键帧 */
+};
+
+static struct telem_conn conn_ctx[CONFIG_BT_MAX_CONN];
+static struct k_work_delayable publish_work;
+
+/* 字段变化监听者 (只在初始化阶段注册，之后只读) */
+static sys_slist_t listeners = SYS_SLIST_STATIC_INIT(&listeners);
+
+/**
+ * @brief 计算相对该连接上次发送值超出死区的字段
+ */
+static uint8_t changed_mask(const struct telem_conn *ctx)
+{
+    uint8_t mask = 0;
+
+    for (uint8_t f = 0; f < TELEM_FIELD_COUNT; f++) {
+        int32_t diff = (int32_t)atomic_get(&field_value[f]) - ctx->sent[f];
+
+        if (field_desc[f].deadband == 0 ? (diff != 0)
+                                         : ((uint32_t)abs(diff) > field_desc[f].deadband)) {
+            mask |= BIT(f);
+        }
+    }
+
+    return mask;
+}
+
+/**
+ * @brief 按位图顺序把字段值紧凑写入负载
+ * @return 负载长度
+ */
+static uint8_t encode_payload(uint8_t seq, uint8_t mask, uint8_t *payload,
+                              int32_t values[TELEM_FIELD_COUNT])
+{
+    uint8_t len = 0;
+
+    payload[len++] = seq;
+    payload[len++] = mask;
+
+    for (uint8_t f = 0; f < TELEM_FIELD_COUNT; f++) {
+        if (!(mask & BIT(f))) {
+            continue;
+        }
+
+        values[f] = (int32_t)atomic_get(&field_value[f]);
+
+        switch (field_desc[f].size) {
+        case 1:
+            payload[len] = (uint8_t)values[f];
+            break;
+        case 2:
+            sys_put_le16((uint16_t)values[f], &payload[len]);
+            break;
+        default:
+            sys_put_le32((uint32_t)values[f], &payload[len]);
+            break;
+        }
+        len += field_desc[f].size;
+    }
+
+    return len;
+}
+
+static void deadline_update(int64_t *next, int64_t deadline)
+{
+    if (deadline < *next) {
+        *next = deadline;
+    }
+}
+
+/**
+ * @brief 对单个连接执行一次发布检查 (bt_conn_foreach 回调)
+ */
+static void publish_conn(struct bt_conn *conn, void *user_data)
+{
+    int64_t *next = user_data;
+    struct telem_conn *ctx = &conn_ctx[bt_conn_index(conn)];
+    int64_t now = k_uptime_get();
+
+    if (!gatt_svc_notify_enabled(conn)) {
+        atomic_clear_bit(&ctx->flags, CONN_FLAG_SUBSCRIBED);
+        return;
+    }
+
+    /* 链路就绪前不推送，就绪回调会再次触发发布 */
+    if (!conn_setup_is_ready(conn)) {
+        return;
+    }
+
+    /* 新订阅者或关键帧周期到达: 发送全部字段 */
+    if (!atomic_test_and_set_bit(&ctx->flags, CONN_FLAG_SUBSCRIBED) ||
+        now - ctx->last_key_ms >= CONFIG_APP_TELEMETRY_KEYFRAME_INTERVAL_MS) {
+        atomic_set_bit(&ctx->flags, CONN_FLAG_KEYFRAME);
+    }
+
+    bool keyframe = atomic_test_bit(&ctx->flags, CONN_FLAG_KEYFRAME);
+    uint8_t mask = keyframe ? TELEM_ALL_FIELDS : changed_mask(ctx);
+
+    if (mask == 0) {
+        deadline_update(next, ctx->last_key_ms + CONFIG_APP_TELEMETRY_KEYFRAME_INTERVAL_MS);
+        return;
+    }
+
+    /* 每个连接限速，变化在窗口结束时合并为一帧发送 */
+    if (ctx->last_tx_ms != 0 && now - ctx->last_tx_ms < CONFIG_APP_TELEMETRY_MIN_INTERVAL_MS) {
+        deadline_update(next, ctx->last_tx_ms + CONFIG_APP_TELEMETRY_MIN_INTERVAL_MS);
+        return;
+    }
+
+    uint8_t payload[TELEM_PAYLOAD_MAX];
+    uint8_t frame[TELEM_FRAME_MAX];
+    uint8_t frame_len = 0;
+    int32_t values[TELEM_FIELD_COUNT];
+    uint8_t payload_len = encode_payload(ctx->seq, mask, payload, values);
+
+    param_pack_frame(keyframe ? CMD_FTE_TelemetryKeyFrame : CMD_FTE_TelemetryDelta,
+                     payload, payload_len, frame, &frame_len);
+
+    int err = gatt_svc_notify(conn, frame, frame_len);
+    if (err) {
+        /* 发送缓冲区不足等情况: 保留变化，稍后重试 */
+        LOG_WRN("Telemetry notify failed (err %d)", err);
+        deadline_update(next, now + CONFIG_APP_TELEMETRY_MIN_INTERVAL_MS);
+        return;
+    }
+
+    for (uint8_t f = 0; f < TELEM_FIELD_COUNT; f++) {
+        if (mask & BIT(f)) {
+            ctx->sent[f] = values[f];
+        }
+    }
+    ctx->last_tx_ms = now;
+    ctx->seq++;
+    if (keyframe) {
+        atomic_clear_bit(&ctx->flags, CONN_FLAG_KEYFRAME);
+        ctx->last_key_ms = now;
+    }
+
+    LOG_DBG("Telemetry %s sent, mask 0x%02x, len %u",
+            keyframe ? "keyframe" : "delta", mask, frame_len);
+
+    deadline_update(next, ctx->last_key_ms + CONFIG_APP_TELEMETRY_KEYFRAME_INTERVAL_MS);
+}
+
+/**
+ * @brief 发布工作项: 检查所有连接，并按最早的截止时间重新调度
+ */
+static void publish_handler(struct k_work *work)
+{
+    int64_t next = INT64_MAX;
+
+    bt_conn_foreach(BT_CONN_TYPE_LE, publish_conn, &next);
+
+    if (next != INT64_MAX) {
+        int64_t delay = next - k_uptime_get();
+
+        /* telemetry_set() 期间可能已重新提交，此时不覆盖 */
+        k_work_schedule(&publish_work, K_MSEC(MAX(delay, 0)));
+    }
+}
+
+void telemetry_init(void)
+{
+    for (uint8_t f = 0; f < TELEM_FIELD_COUNT; f++) {
+        atomic_set(&field_value[f], field_desc[f].init);
+    }
+
+    k_work_init_delayable(&publish_work, publish_handler);
+}
+
+void telemetry_set(enum telem_field field, int32_t value)
+{
+    if (field >= TELEM_FIELD_COUNT) {
+        return;
+    }
+
+    if ((int32_t)atomic_set(&field_value[field], value) != value) {
+        LOG_DBG("Telemetry %s = %d", field_desc[field].name, value);
+        /* 立即检查，通知在下一个连接事件发出 */
+        k_work_reschedule(&publish_work, K_NO_WAIT);
+
+        struct telemetry_listener *listener;
+
+        SYS_SLIST_FOR_EACH_CONTAINER(&listeners, listener, node) {
+            if (listener->field_mask & BIT(field)) {
+                listener->changed(field, value);
+            }
+        }
+    }
+}
+
+void telemetry_listener_register(struct telemetry_listener *listener)
+{
+    sys_slist_append(&listeners, &listener->node);
+}
+
+int32_t telemetry_get(enum telem_field field)
+{
+    if (field >= TELEM_FIELD_COUNT) {
+        return 0;
+    }
+
+    return (int32_t)atomic_get(&field_value[field]);
+}
+
+void telemetry_resync(void)
+{
+    k_work_reschedule(&publish_work, K_NO_WAIT);
+}
+
+void telemetry_conn_reset(struct bt_conn *conn)
+{
+    struct telem_conn *ctx = &conn_ctx[bt_conn_index(conn)];
+
+    atomic_clear(&ctx->flags);
+    ctx->last_tx_ms = 0;
+    ctx->last_key_ms = 0;
+    ctx->seq = 0;
+}